@@ -0,0 +1,80 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+
+#define LAUNCHPADD_IMPL
+#define LAUNCHPADD_LOG_ERROR
+#include "launchpadd.h"
+
+bool should_run = true; //!< whether the main loop should continue running
+
+/// @brief signal handler for ctrl+c
+void handle_sigint(int) {
+    should_run = false;
+}
+
+/// @brief main function
+/// @param argc argument count
+/// @param argv arguments (optional priority and shared memory name)
+/// @return 0 on success, 1 on failure
+int main(int argc, char** argv) {
+    signal(SIGINT, handle_sigint); // register signal handler for ctrl+c
+
+    // attach to launchpadd
+    launchpadd_client_t client = {
+        .shm_name = argc > 2 ? argv[2] : NULL,
+        .priority = argc > 1 ? strtoul(argv[1], NULL, 10) : 0
+    };
+    launchpadd_status status = launchpadd_attach(&client);
+    if (status != LAUNCHPADD_STATUS_OK) {
+        fprintf(stderr, "failed to attach to launchpadd: %d\n", status);
+        return 1;
+    }
+
+    // loop until ctrl+c
+    srand(time(NULL));
+    while (should_run) {
+        // sleep for 100ms
+        usleep(100000); // 100ms
+
+        // light a random grid led with a random color, the rest shows lower priority clients
+        uint8_t led = (rand() % 8 + 1) * 10 + (rand() % 8 + 1); // main grid uses 11-88 in session layout
+        launchpadd_set_led(&client, led, false, rand() % 64, rand() % 64, rand() % 64);
+
+        // hold pressed buttons white, release them back to transparent
+        launchpadd_input_t input;
+        while ((status = launchpadd_poll(&client, &input)) == LAUNCHPADD_STATUS_OK) {
+            printf("%s: button=%d, state=%d\n", input.is_controller ? "Controller" : "Noteon", input.button, input.state);
+
+            if (input.state)
+                launchpadd_set_led(&client, input.button, input.is_controller, 63, 63, 63);
+            else
+                launchpadd_clear_led(&client, input.button, input.is_controller);
+        }
+
+        // publish frame (no syscalls)
+        if (status != LAUNCHPADD_STATUS_ERROR)
+            status = launchpadd_commit(&client);
+
+        // reattach once launchpadd went away or was restarted
+        if (status == LAUNCHPADD_STATUS_ERROR) {
+            fprintf(stderr, "lost launchpadd, reattaching\n");
+            launchpadd_detach(&client);
+            while (should_run && launchpadd_attach(&client) != LAUNCHPADD_STATUS_OK)
+                sleep(1);
+        }
+    }
+
+    // detach from launchpadd
+    if (!client.slot)
+        return 0;
+    status = launchpadd_detach(&client);
+    if (status != LAUNCHPADD_STATUS_OK) {
+        fprintf(stderr, "failed to detach from launchpadd: %d\n", status);
+        return 1;
+    }
+
+    return 0;
+}
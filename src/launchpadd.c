@@ -0,0 +1,426 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#define LAUNCHPAD_IMPL
+#define LAUNCHPAD_LOG_ERROR
+//#define LAUNCHPAD_LOG_TRACE // uncomment to enable trace logging
+#include "launchpadmk2.h"
+#include "launchpadd.h"
+
+#define LAUNCHPADD_FRAME_INTERVAL 1 //!< frame snapshot interval in milliseconds while clients are updating
+#define LAUNCHPADD_IDLE_INTERVAL 20 //!< frame snapshot interval in milliseconds once clients are idle
+#define LAUNCHPADD_IDLE_FRAMES 1000 //!< unchanged snapshots before switching to the idle interval
+#define LAUNCHPADD_REAP_INTERVAL 1000 //!< milliseconds between checks for dead clients
+#define LAUNCHPADD_PUSH_INTERVAL 10 //!< minimum milliseconds between led updates sent to the device
+#define LAUNCHPADD_REFRESH_INTERVAL 1000 //!< milliseconds between full resends of all leds (heals dropped sysex messages)
+
+bool should_run = true; //!< whether the main loop should continue running
+int shm_fd = -1; //!< shared memory file descriptor (used to check slot locks)
+launchpadd_shm_t* shm = NULL; //!< shared memory segment
+
+uint32_t slot_seq[LAUNCHPADD_CLIENTS]; //!< last seen frame sequence of each slot
+uint32_t slot_word[LAUNCHPADD_CLIENTS]; //!< last seen slot word of each used slot (0 if not used)
+launchpadd_frame_t slot_frame[LAUNCHPADD_CLIENTS]; //!< last consistent frame of each slot
+uint8_t device_rgb[LAUNCHPADD_LEDS][3]; //!< colors last sent to the device successfully
+
+/// @brief signal handler for ctrl+c and termination
+void handle_signal(int) {
+    should_run = false;
+}
+
+/// @brief publish input event to the input ring
+/// @param button button number
+/// @param is_controller is controller button
+/// @param state button state
+void publish_input(uint8_t button, bool is_controller, bool state) {
+    // single producer, so the head can be advanced without a cas
+    uint64_t seq = atomic_load_explicit(&shm->input_head, memory_order_relaxed);
+    launchpadd_input_t input = { .button = button, .is_controller = is_controller, .state = state };
+    atomic_store_explicit(&shm->input[seq & (LAUNCHPADD_INPUT_SIZE - 1)], launchpadd_input_encode(seq + 1, input), memory_order_release);
+    atomic_store_explicit(&shm->input_head, seq + 1, memory_order_release);
+}
+
+/// @brief handle button presses on the main 8x8 grid and right side buttons
+/// @param button button number
+/// @param state button state
+void on_noteon(uint8_t button, bool state) {
+    publish_input(button, false, state);
+}
+
+/// @brief handle button presses on the top row
+/// @param button button number
+/// @param state button state
+void on_controller(uint8_t button, bool state) {
+    publish_input(button, true, state);
+}
+
+/// @brief get monotonic time
+/// @return monotonic time in milliseconds
+uint64_t monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/// @brief release slots of clients that exited without detaching
+void reap_clients() {
+    for (int i = 0; i < LAUNCHPADD_CLIENTS; i++) {
+        launchpadd_slot_t* slot = &shm->slots[i];
+        uint32_t word = atomic_load_explicit(&slot->state, memory_order_acquire);
+        if (launchpadd_slot_get_state(word) == LAUNCHPADD_SLOT_FREE)
+            continue;
+
+        // clients hold the slot lock from before claiming until after freeing, so an unlocked slot is abandoned
+        if (launchpadd_is_locked(shm_fd, i))
+            continue;
+
+        // take the slot over from exactly the observed owner, then free it
+        uint32_t generation = launchpadd_slot_get_generation(word);
+        if (!atomic_compare_exchange_strong(&slot->state, &word, launchpadd_slot_word(generation, LAUNCHPADD_SLOT_CLAIMED)))
+            continue;
+
+        int32_t pid = atomic_exchange_explicit(&slot->pid, 0, memory_order_relaxed);
+        atomic_store_explicit(&slot->state, launchpadd_slot_word(generation, LAUNCHPADD_SLOT_FREE), memory_order_release);
+        fprintf(stderr, "released slot %d of dead client %d\n", i, pid);
+    }
+}
+
+/// @brief copy changed client frames out of shared memory
+/// @return whether any visible client state changed
+bool snapshot_clients() {
+    bool changed = false;
+
+    for (int i = 0; i < LAUNCHPADD_CLIENTS; i++) {
+        launchpadd_slot_t* slot = &shm->slots[i];
+        uint32_t word = atomic_load_explicit(&slot->state, memory_order_acquire);
+        if (launchpadd_slot_get_state(word) != LAUNCHPADD_SLOT_USED)
+            word = 0; // not visible until set up
+
+        // the generation changes on every attach, so a quick detach and re-attach still resets the slot
+        if (word != slot_word[i]) {
+            slot_word[i] = word;
+            slot_seq[i] = 0;
+            memset(&slot_frame[i], 0, sizeof(launchpadd_frame_t));
+            changed = true;
+        }
+        if (!word)
+            continue;
+
+        // read seqlock, skip the slot if the client is writing and try again next iteration
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == slot_seq[i] || (seq & 1))
+            continue;
+
+        launchpadd_frame_t frame;
+        memcpy(&frame, &slot->frame, sizeof(launchpadd_frame_t));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq || atomic_load_explicit(&slot->state, memory_order_relaxed) != word)
+            continue;
+
+        slot_seq[i] = seq;
+        slot_frame[i] = frame;
+        changed = true;
+    }
+
+    return changed;
+}
+
+/// @brief composite client frames by priority and send changed leds
+/// @param launchpad launchpad device handle
+/// @param full send all leds, not only the changed ones
+/// @return ::LAUNCHPAD_SUCCESS, ::LAUNCHPAD_ERROR
+launchpad_status composite_clients(launchpad_t* launchpad, bool full) {
+    uint8_t composite[LAUNCHPADD_LEDS][3];
+    uint8_t leds_idx[LAUNCHPADD_LEDS];
+    uint8_t leds_col[LAUNCHPADD_LEDS * 3];
+    int size = 0;
+
+    for (int led = 0; led < LAUNCHPADD_LEDS; led++) {
+        // highest priority opaque client wins, ties go to the lower slot
+        uint8_t rgb[3] = { 0, 0, 0 };
+        int64_t best = -1;
+        for (int i = 0; i < LAUNCHPADD_CLIENTS; i++) {
+            if (!slot_word[i] || !slot_frame[i].opaque[led])
+                continue;
+
+            uint32_t priority = atomic_load_explicit(&shm->slots[i].priority, memory_order_relaxed);
+            if ((int64_t) priority > best) {
+                best = priority;
+                memcpy(rgb, slot_frame[i].rgb[led], 3);
+            }
+        }
+
+        // frames come from a shared segment, so never let a byte above 0x7F into the sysex
+        rgb[0] &= 0x3F;
+        rgb[1] &= 0x3F;
+        rgb[2] &= 0x3F;
+
+        memcpy(composite[led], rgb, 3);
+        if (!full && memcmp(device_rgb[led], rgb, 3) == 0)
+            continue;
+
+        leds_idx[size] = launchpadd_led_from_index(led);
+        memcpy(&leds_col[size * 3], rgb, 3);
+        size++;
+    }
+
+    if (size == 0)
+        return LAUNCHPAD_STATUS_OK;
+
+    // only remember what actually reached the sequencer, so a failed send is retried in full
+    launchpad_status status = launchpad_set_leds_rgb(launchpad, leds_idx, leds_col, size);
+    if (status == LAUNCHPAD_STATUS_OK)
+        memcpy(device_rgb, composite, sizeof(device_rgb));
+    return status;
+}
+
+/// @brief report the instance holding the daemon lock of a segment
+/// @param fd shared memory file descriptor
+/// @param name name of the shared memory segment
+void report_running(int fd, const char* name) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(launchpadd_shm_t)) {
+        launchpadd_shm_t* other = mmap(NULL, sizeof(launchpadd_shm_t), PROT_READ, MAP_SHARED, fd, 0);
+        if (other != MAP_FAILED) {
+            bool ready = atomic_load_explicit(&other->magic, memory_order_acquire) == LAUNCHPADD_MAGIC;
+            int32_t pid = other->pid;
+            munmap(other, sizeof(launchpadd_shm_t));
+            if (ready) {
+                fprintf(stderr, "launchpadd is already running (pid %d)\n", pid);
+                return;
+            }
+        }
+    }
+
+    fprintf(stderr, "shared memory segment %s is in use\n", name);
+}
+
+/// @brief open shared memory segment and take the daemon lock
+/// @param name name of the shared memory segment
+/// @return shared memory file descriptor, -1 on failure
+int lock_shm(const char* name) {
+    // the segment is never unlinked while a daemon holds the lock, so retry only when a daemon just shut down
+    for (int attempt = 0; attempt < 3; attempt++) {
+        int fd = shm_open(name, O_RDWR | O_CREAT, 0660);
+        if (fd < 0) {
+            perror("shm_open()");
+            return -1;
+        }
+
+        // the daemon lock is taken before anything else touches the segment and released when a daemon exits
+        if (!launchpadd_lock(fd, LAUNCHPADD_LOCK_DAEMON, F_WRLCK)) {
+            if (errno == EAGAIN || errno == EACCES)
+                report_running(fd, name);
+            else
+                perror("fcntl()");
+            close(fd);
+            return -1;
+        }
+
+        // make sure the name still refers to the locked segment
+        struct stat st_fd, st_name;
+        int check = shm_open(name, O_RDONLY, 0);
+        bool same = check >= 0 && fstat(fd, &st_fd) == 0 && fstat(check, &st_name) == 0 && st_fd.st_ino == st_name.st_ino;
+        if (check >= 0)
+            close(check);
+        if (same)
+            return fd;
+
+        close(fd);
+    }
+
+    fprintf(stderr, "shared memory segment %s keeps changing\n", name);
+    return -1;
+}
+
+/// @brief create shared memory segment, or take over the segment of a previous instance
+/// @param name name of the shared memory segment
+/// @param mode permissions of the segment (-1 to use 0660 masked by the umask)
+/// @return 0 on success, 1 on failure
+int create_shm(const char* name, int mode) {
+    int fd = lock_shm(name);
+    if (fd < 0)
+        return 1;
+
+    // apply permissions on every start, a segment left behind by a previous instance keeps its old mode otherwise
+    if (mode < 0) {
+        mode_t mask = umask(0);
+        umask(mask);
+        mode = 0660 & ~mask;
+    }
+    if (fchmod(fd, mode) < 0) {
+        perror("fchmod()");
+        close(fd);
+        return 1;
+    }
+
+    if (ftruncate(fd, sizeof(launchpadd_shm_t)) < 0) {
+        perror("ftruncate()");
+        close(fd);
+        return 1;
+    }
+
+    shm = mmap(NULL, sizeof(launchpadd_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (shm == MAP_FAILED) {
+        perror("mmap()");
+        shm = NULL;
+        close(fd);
+        return 1;
+    }
+    shm_fd = fd;
+
+    // reinitialise in place, so all slots are free and the input ring is empty (zeroing the mapping instead of
+    // truncating to zero keeps clients of a previous instance from faulting on a shrunken segment)
+    atomic_store_explicit(&shm->magic, 0, memory_order_release);
+    memset(shm, 0, sizeof(launchpadd_shm_t));
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    shm->pid = getpid();
+    shm->version = LAUNCHPADD_VERSION;
+    atomic_store_explicit(&shm->epoch, ((uint64_t) shm->pid << 32) ^ ((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec), memory_order_relaxed);
+    atomic_store_explicit(&shm->magic, LAUNCHPADD_MAGIC, memory_order_release);
+    return 0;
+}
+
+/// @brief destroy shared memory segment
+/// @param name name of the shared memory segment
+void destroy_shm(const char* name) {
+    shm_unlink(name); // unlink before dropping the daemon lock, so a new instance never takes over a dead name
+    munmap(shm, sizeof(launchpadd_shm_t));
+    close(shm_fd);
+    shm = NULL;
+    shm_fd = -1;
+}
+
+/// @brief main function
+/// @param argc argument count
+/// @param argv arguments (optional launchpad port name, shared memory name and octal permissions)
+/// @return 0 on success, 1 on failure
+int main(int argc, char** argv) {
+    signal(SIGINT, handle_signal); // register signal handler for ctrl+c
+    signal(SIGTERM, handle_signal);
+
+    const char* shm_name = argc > 2 ? argv[2] : LAUNCHPADD_SHM_NAME;
+
+    int mode = -1;
+    if (argc > 3) {
+        char* end;
+        mode = strtol(argv[3], &end, 8);
+        if (*end || end == argv[3] || mode < 0 || mode > 0777) {
+            fprintf(stderr, "invalid permissions: %s\n", argv[3]);
+            return 1;
+        }
+    }
+
+    // create shared memory segment before touching the launchpad, so a second instance leaves it alone
+    if (create_shm(shm_name, mode))
+        return 1;
+
+    // open launchpad
+    launchpad_t launchpad = {
+        .client_name = "launchpadd",
+        .port_name = argc > 1 ? argv[1] : "Launchpad MK2",
+        .on_noteon = on_noteon,
+        .on_controller = on_controller
+    };
+    launchpad_status status = launchpad_open(&launchpad);
+    if (status != LAUNCHPAD_STATUS_OK) {
+        fprintf(stderr, "failed to open launchpad: %d\n", status);
+        destroy_shm(shm_name);
+        return 1;
+    }
+
+    // set launchpad to session mode and clear it, so the device matches the empty composite
+    status = launchpad_set_mode(&launchpad, LAUNCHPAD_MODE_SESSION);
+    if (status == LAUNCHPAD_STATUS_OK)
+        status = launchpad_set_leds_all(&launchpad, 0);
+    if (status != LAUNCHPAD_STATUS_OK) {
+        fprintf(stderr, "failed to reset launchpad: %d\n", status);
+        launchpad_close(&launchpad);
+        destroy_shm(shm_name);
+        return 1;
+    }
+
+    // input wakes the loop directly, clients publish frames without syscalls so those are picked up on a timer
+    int nfds = snd_seq_poll_descriptors_count(launchpad.seq_handle, POLLIN);
+    struct pollfd fds[nfds];
+    snd_seq_poll_descriptors(launchpad.seq_handle, fds, nfds, POLLIN);
+
+    uint64_t now = monotonic_ms();
+    uint64_t next_frame = now, next_reap = now, next_push = now;
+    uint64_t next_refresh = now + LAUNCHPADD_REFRESH_INTERVAL;
+    int idle_frames = 0;
+    bool dirty = false, push_failed = false;
+
+    // loop until signal or error
+    while (should_run) {
+        int ready = poll(fds, nfds, next_frame > now ? (int) (next_frame - now) : 0);
+        if (ready < 0 && errno != EINTR) {
+            perror("poll()");
+            status = LAUNCHPAD_STATUS_ERROR;
+            break;
+        }
+
+        // forward all pending input events
+        if (ready > 0) {
+            do status = launchpad_poll(&launchpad);
+            while (status == LAUNCHPAD_STATUS_OK);
+            if (status == LAUNCHPAD_STATUS_ERROR)
+                break;
+        }
+
+        now = monotonic_ms();
+        if (now < next_frame)
+            continue;
+
+        if (now >= next_reap) {
+            reap_clients();
+            next_reap = now + LAUNCHPADD_REAP_INTERVAL;
+        }
+
+        // snapshot often, but back off while nothing changes
+        if (snapshot_clients()) {
+            idle_frames = 0;
+            dirty = true;
+        } else if (idle_frames < LAUNCHPADD_IDLE_FRAMES) {
+            idle_frames++;
+        }
+
+        // push only changed leds at a rate the device keeps up with, failed pushes are retried on the next one
+        bool refresh = now >= next_refresh;
+        if ((dirty || refresh) && now >= next_push) {
+            if (composite_clients(&launchpad, refresh) == LAUNCHPAD_STATUS_OK) {
+                dirty = false;
+                push_failed = false;
+                if (refresh)
+                    next_refresh = now + LAUNCHPADD_REFRESH_INTERVAL;
+            } else if (!push_failed) {
+                fprintf(stderr, "failed to update launchpad, retrying\n");
+                push_failed = true;
+            }
+            next_push = now + LAUNCHPADD_PUSH_INTERVAL;
+        }
+        next_frame = now + (idle_frames < LAUNCHPADD_IDLE_FRAMES ? LAUNCHPADD_FRAME_INTERVAL : LAUNCHPADD_IDLE_INTERVAL);
+    }
+
+    // tear down shared memory segment and clear launchpad
+    destroy_shm(shm_name);
+    launchpad_set_leds_all(&launchpad, 0);
+
+    // close launchpad
+    status = launchpad_close(&launchpad);
+    if (status != LAUNCHPAD_STATUS_OK) {
+        fprintf(stderr, "failed to close launchpad: %d\n", status);
+        return 1;
+    }
+
+    snd_config_update_free_global();
+
+    return 0;
+}
@@ -0,0 +1,448 @@
+/// \file launchpadd.h shared memory client for the launchpad frame server
+
+// (make sure to define _GNU_SOURCE before any include, LAUNCHPADD_IMPL in one of the source files (c or c++23) and optionally LAUNCHPADD_LOG_ERROR, then start launchpadd before attaching)
+
+#ifndef LAUNCHPADD_H
+#define LAUNCHPADD_H
+
+#ifdef __cplusplus
+#if __cplusplus > 202002L
+#include <stdatomic.h>
+#define LAUNCHPADD_ATOMIC(T) _Atomic(T) //!< atomic type of the shared layout
+#else
+#include <atomic>
+#define LAUNCHPADD_ATOMIC(T) std::atomic<T> //!< atomic type of the shared layout
+#ifdef LAUNCHPADD_IMPL
+#error "LAUNCHPADD_IMPL requires c or c++23 (<stdatomic.h>)"
+#endif
+#endif
+#define LAUNCHPADD_ALIGNAS(n) alignas(n) //!< alignment of the shared layout
+extern "C" {
+#else
+#include <stdatomic.h>
+#define LAUNCHPADD_ATOMIC(T) _Atomic(T) //!< atomic type of the shared layout
+#define LAUNCHPADD_ALIGNAS(n) _Alignas(n) //!< alignment of the shared layout
+#endif
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef F_OFD_SETLK
+#error "launchpadd.h requires open file description locks, define _GNU_SOURCE before any include"
+#endif
+
+#define LAUNCHPADD_SHM_NAME "/launchpadd" //!< default name of the shared memory segment
+#define LAUNCHPADD_MAGIC 0x4C503244 //!< magic value of the shared memory segment ("LP2D")
+#define LAUNCHPADD_VERSION 1 //!< version of the shared memory layout
+
+#define LAUNCHPADD_LEDS 80 //!< number of leds (8x8 grid, right side and top row)
+#define LAUNCHPADD_CLIENTS 16 //!< maximum number of attached clients
+#define LAUNCHPADD_INPUT_SIZE 256 //!< size of the input ring (power of two)
+#define LAUNCHPADD_LOCK_DAEMON LAUNCHPADD_CLIENTS //!< lock byte held by the running daemon
+#define LAUNCHPADD_CHECK_INTERVAL 100 //!< milliseconds between checks in ::launchpadd_poll whether the daemon is still running
+
+typedef enum {
+    LAUNCHPADD_STATUS_OK = 0, //!< success
+    LAUNCHPADD_STATUS_ERROR = 1, //!< error
+    LAUNCHPADD_STATUS_NO_EVENTS = -1, //!< no events
+} launchpadd_status; //!< launchpadd status
+
+typedef enum {
+    LAUNCHPADD_SLOT_FREE, //!< slot is unused
+    LAUNCHPADD_SLOT_CLAIMED, //!< slot is being set up by a client
+    LAUNCHPADD_SLOT_USED, //!< slot is owned by a client
+} launchpadd_slot_state; //!< client slot state
+
+typedef struct {
+    uint8_t rgb[LAUNCHPADD_LEDS][3]; //!< led colors (r, g, b; 0 to 63)
+    bool opaque[LAUNCHPADD_LEDS]; //!< whether the client drives the led (otherwise lower priorities show through)
+} launchpadd_frame_t; //!< frame of a single client
+
+typedef struct {
+    LAUNCHPADD_ALIGNAS(64) LAUNCHPADD_ATOMIC(uint32_t) state; //!< slot generation and state (see ::launchpadd_slot_word)
+    LAUNCHPADD_ATOMIC(int32_t) pid; //!< pid of the owning process (informational, liveness is tracked through the slot lock)
+    LAUNCHPADD_ATOMIC(uint32_t) priority; //!< compositing priority (higher wins)
+    LAUNCHPADD_ATOMIC(uint32_t) seq; //!< frame seqlock (odd while writing)
+    launchpadd_frame_t frame; //!< published frame
+} launchpadd_slot_t; //!< client slot
+
+typedef struct {
+    LAUNCHPADD_ATOMIC(uint32_t) magic; //!< ::LAUNCHPADD_MAGIC (stored last, once the segment is set up)
+    uint32_t version; //!< ::LAUNCHPADD_VERSION
+    int32_t pid; //!< pid of the daemon
+    LAUNCHPADD_ATOMIC(uint64_t) epoch; //!< daemon instance, changes whenever a daemon takes over the segment
+
+    LAUNCHPADD_ALIGNAS(64) LAUNCHPADD_ATOMIC(uint64_t) input_head; //!< number of input events written
+    LAUNCHPADD_ATOMIC(uint64_t) input[LAUNCHPADD_INPUT_SIZE]; //!< input ring (sequence << 24 | is_controller << 16 | button << 8 | state)
+
+    launchpadd_slot_t slots[LAUNCHPADD_CLIENTS]; //!< client slots
+} launchpadd_shm_t; //!< shared memory layout
+
+// atomics in the segment are shared between processes, which only works if they never fall back to process local locks
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "launchpadd requires lock-free 32-bit and 64-bit atomics");
+
+// c and c++ clients have to agree on the layout of the segment
+static_assert(sizeof(LAUNCHPADD_ATOMIC(uint32_t)) == 4 && sizeof(LAUNCHPADD_ATOMIC(uint64_t)) == 8, "launchpadd requires plain sized atomics");
+static_assert(offsetof(launchpadd_shm_t, epoch) == 16 && offsetof(launchpadd_shm_t, input_head) == 64, "launchpadd header layout mismatch");
+static_assert(sizeof(launchpadd_slot_t) == 384 && offsetof(launchpadd_shm_t, slots) == 2176, "launchpadd slot layout mismatch");
+static_assert(sizeof(launchpadd_shm_t) == 8320, "launchpadd shared memory layout mismatch");
+
+typedef struct {
+    uint8_t button; //!< button number (session layout)
+    bool is_controller; //!< is controller button (top row)
+    bool state; //!< button state
+} launchpadd_input_t; //!< input event
+
+typedef struct {
+    const char* shm_name; //!< [in] name of the shared memory segment (can be NULL)
+    uint32_t priority; //!< [in] compositing priority (higher wins)
+
+    launchpadd_frame_t frame; //!< [in] frame to publish on ::launchpadd_commit
+
+    int shm_fd; //!< shared memory file descriptor (holds the slot lock)
+    launchpadd_shm_t* shm; //!< shared memory segment
+    launchpadd_slot_t* slot; //!< claimed client slot
+    uint64_t input_cursor; //!< next input event to read
+    uint64_t epoch; //!< daemon instance the client attached to
+    uint64_t checked_ms; //!< time of the last daemon check
+} launchpadd_client_t; //!< launchpadd client handle
+
+/// @brief pack slot generation and state into a slot word
+/// @param generation slot generation (bumped on every attach)
+/// @param state slot state
+/// @return slot word
+static inline uint32_t launchpadd_slot_word(uint32_t generation, launchpadd_slot_state state) {
+    return (generation << 2) | state;
+}
+
+/// @brief get slot state of a slot word
+/// @param word slot word
+/// @return slot state
+static inline launchpadd_slot_state launchpadd_slot_get_state(uint32_t word) {
+    return (launchpadd_slot_state) (word & 0x3);
+}
+
+/// @brief get slot generation of a slot word
+/// @param word slot word
+/// @return slot generation
+static inline uint32_t launchpadd_slot_get_generation(uint32_t word) {
+    return word >> 2;
+}
+
+/// @brief set or release a lock byte of the shared memory segment (byte i belongs to slot i)
+/// @param fd shared memory file descriptor
+/// @param byte lock byte
+/// @param type F_WRLCK to lock, F_UNLCK to unlock
+/// @return whether the lock was set or released
+static inline bool launchpadd_lock(int fd, int byte, short type) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = byte;
+    lock.l_len = 1;
+    return fcntl(fd, F_OFD_SETLK, &lock) == 0;
+}
+
+/// @brief check whether a lock byte of the shared memory segment is held by another open file description
+/// @param fd shared memory file descriptor
+/// @param byte lock byte
+/// @return whether the lock is held (or could not be checked)
+static inline bool launchpadd_is_locked(int fd, int byte) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = byte;
+    lock.l_len = 1;
+    if (fcntl(fd, F_OFD_GETLK, &lock) < 0)
+        return true;
+    return lock.l_type != F_UNLCK;
+}
+
+/// @brief get frame index of led
+/// @param idx led index (11 to 89 or 104 to 111)
+/// @param is_controller is controller led (top row)
+/// @return frame index (0 to 79), -1 if invalid
+static inline int launchpadd_led_index(uint8_t idx, bool is_controller) {
+    if (is_controller)
+        return (idx >= 104 && idx <= 111) ? 72 + (idx - 104) : -1;
+
+    int row = idx / 10, col = idx % 10;
+    if (row < 1 || row > 8 || col < 1 || col > 9)
+        return -1;
+    return (row - 1) * 9 + (col - 1);
+}
+
+/// @brief get led of frame index
+/// @param frame_idx frame index (0 to 79)
+/// @return led index (11 to 89 or 104 to 111)
+static inline uint8_t launchpadd_led_from_index(int frame_idx) {
+    if (frame_idx >= 72)
+        return 104 + (frame_idx - 72);
+    return (frame_idx / 9 + 1) * 10 + (frame_idx % 9 + 1);
+}
+
+/// @brief encode input event for the input ring
+/// @param seq sequence number of the event
+/// @param input input event
+/// @return encoded ring entry
+static inline uint64_t launchpadd_input_encode(uint64_t seq, launchpadd_input_t input) {
+    return (seq << 24) | ((uint64_t) input.is_controller << 16) | ((uint64_t) input.button << 8) | input.state;
+}
+
+#ifndef LAUNCHPADD_IMPL
+
+/// @brief attach to launchpadd and claim a client slot (the slot is released when the process exits)
+/// @param client launchpadd client handle
+/// @return ::LAUNCHPADD_STATUS_OK, ::LAUNCHPADD_STATUS_ERROR
+launchpadd_status launchpadd_attach(launchpadd_client_t* client);
+
+/// @brief check whether the daemon the client attached to is still serving it (detach and attach again otherwise)
+/// @param client launchpadd client handle
+/// @return ::LAUNCHPADD_STATUS_OK, ::LAUNCHPADD_STATUS_ERROR
+launchpadd_status launchpadd_check(launchpadd_client_t* client);
+
+/// @brief release client slot and detach from launchpadd
+/// @param client launchpadd client handle
+/// @return ::LAUNCHPADD_STATUS_OK, ::LAUNCHPADD_STATUS_ERROR
+launchpadd_status launchpadd_detach(launchpadd_client_t* client);
+
+/// @brief set led in client frame (does not publish)
+/// @param client launchpadd client handle
+/// @param idx led index (11 to 89 or 104 to 111)
+/// @param is_controller is controller led (top row)
+/// @param r red (0 to 63)
+/// @param g green (0 to 63)
+/// @param b blue (0 to 63)
+/// @return ::LAUNCHPADD_STATUS_OK, ::LAUNCHPADD_STATUS_ERROR
+launchpadd_status launchpadd_set_led(launchpadd_client_t* client, uint8_t idx, bool is_controller, uint8_t r, uint8_t g, uint8_t b);
+
+/// @brief make led in client frame transparent (does not publish)
+/// @param client launchpadd client handle
+/// @param idx led index (11 to 89 or 104 to 111)
+/// @param is_controller is controller led (top row)
+/// @return ::LAUNCHPADD_STATUS_OK, ::LAUNCHPADD_STATUS_ERROR
+launchpadd_status launchpadd_clear_led(launchpadd_client_t* client, uint8_t idx, bool is_controller);
+
+/// @brief publish client frame to launchpadd (no syscalls, fails once another daemon took over the segment)
+/// @param client launchpadd client handle
+/// @return ::LAUNCHPADD_STATUS_OK, ::LAUNCHPADD_STATUS_ERROR
+launchpadd_status launchpadd_commit(launchpadd_client_t* client);
+
+/// @brief poll launchpadd for input events (syscall free except for a daemon check every ::LAUNCHPADD_CHECK_INTERVAL ms, events are dropped if the client falls behind)
+/// @param client launchpadd client handle
+/// @param input input event
+/// @return ::LAUNCHPADD_STATUS_OK, ::LAUNCHPADD_STATUS_ERROR, ::LAUNCHPADD_STATUS_NO_EVENTS
+launchpadd_status launchpadd_poll(launchpadd_client_t* client, launchpadd_input_t* input);
+
+#else
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef log_error
+#ifdef LAUNCHPADD_LOG_ERROR
+#define log_error(...) fprintf(stderr, "ERROR: "); fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n");
+#else
+#define log_error(...)
+#endif
+#endif
+
+launchpadd_status launchpadd_attach(launchpadd_client_t* client) {
+    // map shared memory segment
+    int fd = shm_open(client->shm_name ? client->shm_name : LAUNCHPADD_SHM_NAME, O_RDWR, 0);
+    if (fd < 0) {
+        log_error("shm_open() failed: %s", strerror(errno));
+        return LAUNCHPADD_STATUS_ERROR;
+    }
+
+    // the daemon sizes the segment after creating it, mapping it before that would fault on access
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(launchpadd_shm_t)) {
+        log_error("launchpadd shared memory segment is not ready");
+        close(fd);
+        return LAUNCHPADD_STATUS_ERROR;
+    }
+
+    launchpadd_shm_t* shm = (launchpadd_shm_t*) mmap(NULL, sizeof(launchpadd_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (shm == MAP_FAILED) {
+        log_error("mmap() failed: %s", strerror(errno));
+        close(fd);
+        return LAUNCHPADD_STATUS_ERROR;
+    }
+
+    if (atomic_load_explicit(&shm->magic, memory_order_acquire) != LAUNCHPADD_MAGIC || shm->version != LAUNCHPADD_VERSION) {
+        log_error("launchpadd shared memory layout mismatch");
+        munmap(shm, sizeof(launchpadd_shm_t));
+        close(fd);
+        return LAUNCHPADD_STATUS_ERROR;
+    }
+
+    // a segment left behind by a crashed daemon is still valid, but nobody serves it
+    if (!launchpadd_is_locked(fd, LAUNCHPADD_LOCK_DAEMON)) {
+        log_error("launchpadd is not running");
+        munmap(shm, sizeof(launchpadd_shm_t));
+        close(fd);
+        return LAUNCHPADD_STATUS_ERROR;
+    }
+    uint64_t epoch = atomic_load_explicit(&shm->epoch, memory_order_acquire);
+
+    // claim free slot, the lock byte is held until detach or exit so the daemon can tell dead clients apart
+    for (int i = 0; i < LAUNCHPADD_CLIENTS; i++) {
+        launchpadd_slot_t* slot = &shm->slots[i];
+        uint32_t word = atomic_load_explicit(&slot->state, memory_order_acquire);
+        if (launchpadd_slot_get_state(word) != LAUNCHPADD_SLOT_FREE || !launchpadd_lock(fd, i, F_WRLCK))
+            continue;
+
+        uint32_t generation = launchpadd_slot_get_generation(word) + 1;
+        if (!atomic_compare_exchange_strong(&slot->state, &word, launchpadd_slot_word(generation, LAUNCHPADD_SLOT_CLAIMED))) {
+            launchpadd_lock(fd, i, F_UNLCK);
+            continue;
+        }
+
+        atomic_store_explicit(&slot->pid, getpid(), memory_order_relaxed);
+        atomic_store_explicit(&slot->priority, client->priority, memory_order_relaxed);
+        atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+        memset(&slot->frame, 0, sizeof(launchpadd_frame_t));
+        atomic_store_explicit(&slot->state, launchpadd_slot_word(generation, LAUNCHPADD_SLOT_USED), memory_order_release);
+
+        client->shm_fd = fd;
+        client->shm = shm;
+        client->slot = slot;
+        client->input_cursor = atomic_load_explicit(&shm->input_head, memory_order_acquire);
+        client->epoch = epoch;
+        client->checked_ms = 0;
+        return LAUNCHPADD_STATUS_OK;
+    }
+
+    log_error("no free launchpadd client slot");
+    munmap(shm, sizeof(launchpadd_shm_t));
+    close(fd);
+    return LAUNCHPADD_STATUS_ERROR;
+}
+
+launchpadd_status launchpadd_detach(launchpadd_client_t* client) {
+    launchpadd_slot_t* slot = client->slot;
+    if (!slot) return LAUNCHPADD_STATUS_ERROR;
+
+    // free slot before dropping the lock, so nobody can claim it while it is still in use
+    uint32_t word = atomic_load_explicit(&slot->state, memory_order_relaxed);
+    atomic_store_explicit(&slot->pid, 0, memory_order_relaxed);
+    atomic_store_explicit(&slot->state, launchpadd_slot_word(launchpadd_slot_get_generation(word), LAUNCHPADD_SLOT_FREE), memory_order_release);
+    close(client->shm_fd);
+
+    launchpadd_status status = LAUNCHPADD_STATUS_OK;
+    if (munmap(client->shm, sizeof(launchpadd_shm_t)) < 0) {
+        log_error("munmap() failed: %s", strerror(errno));
+        status = LAUNCHPADD_STATUS_ERROR;
+    }
+
+    client->shm_fd = -1;
+    client->shm = NULL;
+    client->slot = NULL;
+    return status;
+}
+
+launchpadd_status launchpadd_set_led(launchpadd_client_t* client, uint8_t idx, bool is_controller, uint8_t r, uint8_t g, uint8_t b) {
+    int i = launchpadd_led_index(idx, is_controller);
+    if (i < 0 || r > 63 || g > 63 || b > 63) return LAUNCHPADD_STATUS_ERROR;
+
+    client->frame.rgb[i][0] = r;
+    client->frame.rgb[i][1] = g;
+    client->frame.rgb[i][2] = b;
+    client->frame.opaque[i] = true;
+    return LAUNCHPADD_STATUS_OK;
+}
+
+launchpadd_status launchpadd_clear_led(launchpadd_client_t* client, uint8_t idx, bool is_controller) {
+    int i = launchpadd_led_index(idx, is_controller);
+    if (i < 0) return LAUNCHPADD_STATUS_ERROR;
+
+    client->frame.opaque[i] = false;
+    return LAUNCHPADD_STATUS_OK;
+}
+
+launchpadd_status launchpadd_check(launchpadd_client_t* client) {
+    if (!client->shm) return LAUNCHPADD_STATUS_ERROR;
+
+    if (atomic_load_explicit(&client->shm->epoch, memory_order_acquire) != client->epoch || !launchpadd_is_locked(client->shm_fd, LAUNCHPADD_LOCK_DAEMON)) {
+        log_error("launchpadd is no longer serving this client");
+        return LAUNCHPADD_STATUS_ERROR;
+    }
+    return LAUNCHPADD_STATUS_OK;
+}
+
+launchpadd_status launchpadd_commit(launchpadd_client_t* client) {
+    launchpadd_slot_t* slot = client->slot;
+    if (!slot) return LAUNCHPADD_STATUS_ERROR;
+
+    // a new daemon reinitialised the segment, the slot is no longer ours
+    if (atomic_load_explicit(&client->shm->epoch, memory_order_relaxed) != client->epoch)
+        return LAUNCHPADD_STATUS_ERROR;
+
+    // single writer seqlock: odd sequence marks the frame as being written
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&slot->frame, &client->frame, sizeof(launchpadd_frame_t));
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+    return LAUNCHPADD_STATUS_OK;
+}
+
+launchpadd_status launchpadd_poll(launchpadd_client_t* client, launchpadd_input_t* input) {
+    launchpadd_shm_t* shm = client->shm;
+    if (!shm) return LAUNCHPADD_STATUS_ERROR;
+
+    if (atomic_load_explicit(&shm->epoch, memory_order_relaxed) != client->epoch)
+        return LAUNCHPADD_STATUS_ERROR;
+
+    // coarse monotonic clock is served from the vdso, so only the actual daemon check costs a syscall
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    uint64_t now = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    if (now - client->checked_ms >= LAUNCHPADD_CHECK_INTERVAL) {
+        client->checked_ms = now;
+        if (launchpadd_check(client) != LAUNCHPADD_STATUS_OK)
+            return LAUNCHPADD_STATUS_ERROR;
+    }
+
+    while (true) {
+        uint64_t head = atomic_load_explicit(&shm->input_head, memory_order_acquire);
+        if (client->input_cursor >= head)
+            return LAUNCHPADD_STATUS_NO_EVENTS;
+
+        // skip events that have already been overwritten
+        if (head - client->input_cursor > LAUNCHPADD_INPUT_SIZE)
+            client->input_cursor = head - LAUNCHPADD_INPUT_SIZE;
+
+        uint64_t seq = client->input_cursor;
+        uint64_t entry = atomic_load_explicit(&shm->input[seq & (LAUNCHPADD_INPUT_SIZE - 1)], memory_order_acquire);
+        if (entry >> 24 != ((seq + 1) & (UINT64_MAX >> 24))) {
+            client->input_cursor = seq + 1; // overwritten while reading, drop event
+            continue;
+        }
+
+        input->is_controller = (entry >> 16) & 0xFF;
+        input->button = (entry >> 8) & 0xFF;
+        input->state = entry & 0xFF;
+        client->input_cursor = seq + 1;
+        return LAUNCHPADD_STATUS_OK;
+    }
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LAUNCHPADD_H